@@ -8,12 +8,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "predictor.h"
 
 FILE *stream;
 char *buf = NULL;
 size_t len = 0;
 
+// Pipeline cost model configuration
+int costModel;          // Report estimated cycles, CPI and MPKI
+int pipelineDepth;      // Front-end stages refilled after a misprediction
+int mispredictPenalty;  // Cycles lost per misprediction (0 uses pipelineDepth)
+float baseCPI;          // CPI with perfect, single-cycle branch prediction
+float instsPerBranch;   // Dynamic instructions per conditional branch
+
+// Multiprogrammed mode configuration
+#define MAX_TRACES 16
+#define TRACE_READ_BUFFER_SIZE (1 << 20)
+int quantum;            // Branches a trace runs before switching to the next one
+int asidHashing;        // Hash a per-trace address space id into every PC
+int saveHistory;        // Save and restore global history on every context switch
+
+uint64_t timerOverhead; // Cost of the pair of timer reads around a timed branch
+
 // Print out the Usage information to stderr
 //
 void
@@ -21,14 +38,29 @@ usage()
 {
   fprintf(stderr,"Usage: predictor <options> [<trace>]\n");
   fprintf(stderr,"       bunzip -kc trace.bz2 | predictor <options>\n");
+  fprintf(stderr,"       predictor <options> <trace> <trace>...  (interleaved)\n");
   fprintf(stderr," Options:\n");
   fprintf(stderr," --help       Print this message\n");
   fprintf(stderr," --verbose    Print predictions on stdout\n");
+  fprintf(stderr," --filter:<# index>\n"
+                 "              Handle strongly biased branches with a per-PC\n"
+                 "              filter in front of the chosen scheme\n");
+  fprintf(stderr," --pipeline:<depth>:<penalty>:<base CPI>:<insts per branch>\n"
+                 "              Estimate cycles, CPI and MPKI with a first-order\n"
+                 "              pipeline model (penalty 0 uses depth)\n");
+  fprintf(stderr," --quantum:<# branches>\n"
+                 "              Branches per time slice when several traces\n"
+                 "              are interleaved on one predictor\n");
+  fprintf(stderr," --asid       Hash a per-trace address space id into PCs\n");
+  fprintf(stderr," --save-history\n"
+                 "              Save and restore global history on switches\n");
   fprintf(stderr," --<type>     Branch prediction scheme:\n");
   fprintf(stderr,"    static\n"
                  "    gshare:<# ghistory>\n"
                  "    tournament:<# ghistory>:<# lhistory>:<# index>\n"
-                 "    custom\n");
+                 "    custom\n"
+                 "    tage:<# index>:<# tables>:<# table index>:<# tag>:<min history>:<max history>\n"
+                 "    hashed:<# tables>:<# table index>:<min history>:<max history>\n");
 }
 
 // Process an option and update the predictor
@@ -49,6 +81,46 @@ handle_option(char *arg)
     sscanf(arg+13,"%d:%d:%d", &ghistoryBits, &lhistoryBits, &pcIndexBits);
   } else if (!strcmp(arg,"--custom")) {
     bpType = CUSTOM;
+  } else if (!strcmp(arg,"--tage") || !strncmp(arg,"--tage:",7)) {
+    // Fields left out of the configuration keep their defaults
+    bpType = TAGE;
+    pcIndexBits = 12;
+    tageTables = 7;
+    tageIndexBits = 9;
+    tageTagBits = 8;
+    tageMinHistory = 4;
+    tageMaxHistory = 200;
+    if (arg[6] == ':') {
+      sscanf(arg+7,"%d:%d:%d:%d:%d:%d", &pcIndexBits, &tageTables, &tageIndexBits,
+             &tageTagBits, &tageMinHistory, &tageMaxHistory);
+    }
+  } else if (!strcmp(arg,"--hashed") || !strncmp(arg,"--hashed:",9)) {
+    // Fields left out of the configuration keep their defaults
+    bpType = HASHED;
+    hashedTables = 16;
+    hashedIndexBits = 9;
+    hashedMinHistory = 3;
+    hashedMaxHistory = 200;
+    if (arg[8] == ':') {
+      sscanf(arg+9,"%d:%d:%d:%d", &hashedTables, &hashedIndexBits, &hashedMinHistory, &hashedMaxHistory);
+    }
+  } else if (!strncmp(arg,"--filter:",9)) {
+    if (sscanf(arg+9,"%d", &filterBits) != 1 || filterBits < 0 || filterBits > FILTER_MAX_BITS) {
+      fprintf(stderr,"Invalid bias filter index bits %s (0 to %d)\n", arg+9, FILTER_MAX_BITS);
+      exit(1);
+    }
+  } else if (!strcmp(arg,"--pipeline") || !strncmp(arg,"--pipeline:",11)) {
+    // Fields left out of the configuration keep their defaults
+    costModel = 1;
+    if (arg[10] == ':') {
+      sscanf(arg+11,"%d:%d:%f:%f", &pipelineDepth, &mispredictPenalty, &baseCPI, &instsPerBranch);
+    }
+  } else if (!strncmp(arg,"--quantum:",10)) {
+    sscanf(arg+10,"%d", &quantum);
+  } else if (!strcmp(arg,"--asid")) {
+    asidHashing = 1;
+  } else if (!strcmp(arg,"--save-history")) {
+    saveHistory = 1;
   } else if (!strcmp(arg,"--verbose")) {
     verbose = 1;
   } else {
@@ -77,13 +149,411 @@ read_branch(uint32_t *pc, uint8_t *outcome)
   return 1;
 }
 
+// Cycles estimated by the cost model. Every misprediction costs the
+// refill penalty, and every branch predicted taken stalls fetch until
+// a multi-cycle lookup finishes
+//
+double
+estimate_cycles(uint32_t num_branches, uint32_t mispredictions, uint32_t predicted_taken)
+{
+  int lookup_latency = get_predictor_lookup_latency();
+  int penalty = mispredictPenalty > 0 ? mispredictPenalty : pipelineDepth;
+
+  return (double)num_branches * instsPerBranch * baseCPI
+       + (double)mispredictions * penalty
+       + (double)predicted_taken * (lookup_latency > 1 ? lookup_latency - 1 : 0);
+}
+
+// Branch counts and sampled predictor cost of one run over a trace
+//
+struct RunStats
+{
+  uint32_t num_branches;
+  uint32_t mispredictions;
+  uint32_t predicted_taken;
+  uint64_t sampled_ns;
+  uint32_t samples;
+};
+
+// Predict and train the branch at 'pc', timing the pair end to end
+// every TIMING_SAMPLE_PERIOD branches. Returns the prediction
+//
+uint8_t
+run_branch(struct RunStats *stats, uint32_t pc, uint8_t outcome)
+{
+  stats->num_branches++;
+
+  // Make a prediction and compare with actual outcome
+  int sampled = stats->num_branches % TIMING_SAMPLE_PERIOD == 0;
+  uint64_t start = sampled ? get_time_ns() : 0;
+  uint8_t prediction = make_prediction(pc);
+  train_predictor(pc, outcome);
+  if (sampled) {
+    uint64_t elapsed = get_time_ns() - start;
+    // Skip samples interrupted by the scheduler
+    if (elapsed <= TIMING_SAMPLE_MAX_NS) {
+      stats->sampled_ns += elapsed > timerOverhead ? elapsed - timerOverhead : 0;
+      stats->samples++;
+    }
+  }
+
+  if (prediction != outcome) {
+    stats->mispredictions++;
+  }
+  if (prediction == TAKEN) {
+    stats->predicted_taken++;
+  }
+  return prediction;
+}
+
+// Average sampled ns/branch of a run
+//
+float
+run_ns_per_branch(struct RunStats *stats)
+{
+  return stats->samples ? (float)stats->sampled_ns / stats->samples : 0;
+}
+
+// Print the cycles, CPI and MPKI estimated by the cost model
+//
+void
+print_cost_model(uint32_t num_branches, uint32_t mispredictions, uint32_t predicted_taken)
+{
+  int lookup_latency = get_predictor_lookup_latency();
+  if (lookup_latency >= pipelineDepth) {
+    fprintf(stderr,"Warning: lookup latency of %d cycles does not fit a %d stage pipeline\n",
+            lookup_latency, pipelineDepth);
+  }
+
+  double instructions = (double)num_branches * instsPerBranch;
+  double cycles = estimate_cycles(num_branches, mispredictions, predicted_taken);
+
+  printf("Lookup Latency:  %10d\n", lookup_latency);
+  printf("Instructions:    %10.0f\n", instructions);
+  printf("Cycles:          %10.0f\n", cycles);
+  printf("CPI:                %7.3f\n", instructions > 0 ? cycles / instructions : 0);
+  printf("MPKI:               %7.3f\n", instructions > 0 ? 1000.0 * mispredictions / instructions : 0);
+}
+
+// A trace loaded into memory, and its results when run alone
+// and interleaved with the other traces
+//
+struct TraceStream
+{
+  const char *path;
+  uint32_t *pcs;
+  uint8_t *outcomes;
+  uint32_t count;
+  uint32_t capacity;
+  int failed;
+
+  uint32_t position;
+  uint32_t alone_mispredictions;
+  uint32_t shared_mispredictions;
+  uint32_t shared_predicted_taken;
+  struct PredictorHistory *history;
+};
+
+// Open a trace for reading. Paths ending in .bz2 are read through
+// bunzip2 and must be closed with close_trace_file
+//
+FILE *
+open_trace_file(const char *path, int *compressed)
+{
+  size_t path_len = strlen(path);
+  *compressed = path_len > 4 && !strcmp(path + path_len - 4, ".bz2");
+
+  FILE *file = NULL;
+  if (*compressed && strchr(path, '\'') == NULL) {
+    char *command = malloc(path_len + 32);
+    sprintf(command, "bunzip2 -kc '%s'", path);
+    file = popen(command, "r");
+    free(command);
+  } else if (!*compressed) {
+    file = fopen(path, "r");
+  }
+  return file;
+}
+
+// Close a trace opened by open_trace_file, returns nonzero if
+// decompressing it failed
+//
+int
+close_trace_file(FILE *file, int compressed)
+{
+  if (compressed) {
+    return pclose(file) != 0;
+  }
+  fclose(file);
+  return 0;
+}
+
+// Append every branch of an open trace to 'trace'
+//
+void
+read_trace_file(struct TraceStream *trace, FILE *file)
+{
+  char *line = NULL;
+  size_t line_len = 0;
+  uint32_t pc, outcome;
+  while (getline(&line, &line_len, file) != -1) {
+    if (sscanf(line,"0x%x %u\n", &pc, &outcome) != 2) {
+      continue;
+    }
+    if (trace->count == trace->capacity) {
+      trace->capacity = trace->capacity ? 2 * trace->capacity : (1 << 16);
+      trace->pcs = realloc(trace->pcs, trace->capacity * sizeof(uint32_t));
+      trace->outcomes = realloc(trace->outcomes, trace->capacity * sizeof(uint8_t));
+      if (trace->pcs == NULL || trace->outcomes == NULL) {
+        trace->failed = 1;
+        break;
+      }
+    }
+    trace->pcs[trace->count] = pc;
+    trace->outcomes[trace->count] = outcome;
+    trace->count++;
+  }
+  free(line);
+}
+
+// Reader thread for one trace. Every trace gets its own buffered
+// stream so all of them are decompressed and parsed concurrently
+//
+void *
+load_trace_stream(void *arg)
+{
+  struct TraceStream *trace = (struct TraceStream *)arg;
+  int compressed;
+  FILE *file = open_trace_file(trace->path, &compressed);
+  if (file == NULL) {
+    trace->failed = 1;
+    return NULL;
+  }
+  setvbuf(file, NULL, _IOFBF, TRACE_READ_BUFFER_SIZE);
+  read_trace_file(trace, file);
+  trace->failed |= close_trace_file(file, compressed);
+  return NULL;
+}
+
+// Next branch of the trace, from memory when it was loaded up
+// front and from the input stream otherwise
+//
+int
+next_branch(struct TraceStream *trace, uint32_t *pc, uint8_t *outcome)
+{
+  if (trace->pcs == NULL) {
+    return read_branch(pc, outcome);
+  }
+  if (trace->position == trace->count) {
+    return 0;
+  }
+  *pc = trace->pcs[trace->position];
+  *outcome = trace->outcomes[trace->position];
+  trace->position++;
+  return 1;
+}
+
+// Run the trace again on a fresh predictor without the bias filter,
+// and report the end to end ns/branch the filter saved (negative
+// when the filter slows the run down)
+//
+void
+print_filter_saving(struct TraceStream *trace, float filtered_ns)
+{
+  int filter_bits = filterBits;
+  gc_predictor();
+  filterBits = 0;
+  init_predictor();
+
+  struct RunStats stats;
+  memset(&stats, 0, sizeof(stats));
+  for (uint32_t i = 0; i < trace->count; ++i) {
+    run_branch(&stats, trace->pcs[i], trace->outcomes[i]);
+  }
+  gc_predictor();
+  filterBits = filter_bits;
+
+  float unfiltered_rate = stats.num_branches ? 100*((float)stats.mispredictions / (float)stats.num_branches) : 0;
+  printf("No filter Rate:     %7.3f\n", unfiltered_rate);
+  printf("No filter ns/branch:%7.3f\n", run_ns_per_branch(&stats));
+  printf("Net saved ns/branch:%7.3f\n", run_ns_per_branch(&stats) - filtered_ns);
+}
+
+// PC as seen by the predictor when it runs in address space 'asid'
+//
+uint32_t
+hash_asid(uint32_t pc, int asid)
+{
+  return asidHashing ? pc ^ (asid * 0x9E3779B1u) : pc;
+}
+
+// Interleave several traces on a single predictor, switching traces
+// every 'quantum' branches, and compare each trace with running it alone
+//
+int
+run_multiprogrammed(char **paths, int num_traces)
+{
+  struct TraceStream traces[MAX_TRACES];
+  pthread_t readers[MAX_TRACES];
+  int started[MAX_TRACES];
+  memset(traces, 0, sizeof(traces));
+
+  // Load all traces concurrently
+  for (int i = 0; i < num_traces; ++i) {
+    traces[i].path = paths[i];
+    started[i] = pthread_create(&readers[i], NULL, load_trace_stream, &traces[i]) == 0;
+    traces[i].failed = !started[i];
+  }
+  for (int i = 0; i < num_traces; ++i) {
+    if (started[i]) {
+      pthread_join(readers[i], NULL);
+    }
+  }
+  for (int i = 0; i < num_traces; ++i) {
+    if (traces[i].failed || traces[i].count == 0) {
+      fprintf(stderr,"Could not read trace %s\n", traces[i].path);
+      exit(1);
+    }
+  }
+
+  // Run every trace alone on a freshly initialized predictor
+  struct RunStats alone;
+  memset(&alone, 0, sizeof(alone));
+  for (int i = 0; i < num_traces; ++i) {
+    struct TraceStream *trace = &traces[i];
+    init_predictor();
+    for (uint32_t j = 0; j < trace->count; ++j) {
+      uint32_t pc = hash_asid(trace->pcs[j], i);
+      if (run_branch(&alone, pc, trace->outcomes[j]) != trace->outcomes[j]) {
+        trace->alone_mispredictions++;
+      }
+    }
+    gc_predictor();
+  }
+
+  // Interleave all traces on a single predictor
+  init_predictor();
+  for (int i = 0; i < num_traces; ++i) {
+    traces[i].history = alloc_predictor_history();
+  }
+
+  uint32_t num_branches = 0;
+  uint32_t mispredictions = 0;
+  uint32_t predicted_taken = 0;
+  uint32_t switches = 0;
+  struct RunStats shared;
+  memset(&shared, 0, sizeof(shared));
+  int remaining = num_traces;
+  int running = -1;
+  for (int i = 0; remaining > 0; i = (i + 1) % num_traces) {
+    struct TraceStream *trace = &traces[i];
+    if (trace->position == trace->count) {
+      continue;
+    }
+    // A trace that keeps running after the others finished is not a switch
+    if (running >= 0 && running != i) {
+      switches++;
+    }
+    running = i;
+    if (saveHistory) {
+      restore_predictor_history(trace->history);
+    }
+
+    uint32_t end = trace->count - trace->position > (uint32_t)quantum ? trace->position + quantum : trace->count;
+    for (; trace->position < end; trace->position++) {
+      uint32_t pc = hash_asid(trace->pcs[trace->position], i);
+      uint8_t outcome = trace->outcomes[trace->position];
+      uint8_t prediction = run_branch(&shared, pc, outcome);
+      if (prediction != outcome) {
+        trace->shared_mispredictions++;
+      }
+      if (prediction == TAKEN) {
+        trace->shared_predicted_taken++;
+      }
+    }
+
+    if (saveHistory) {
+      save_predictor_history(trace->history);
+    }
+    if (trace->position == trace->count) {
+      remaining--;
+    }
+  }
+
+  // Print out the per trace and combined statistics
+  uint32_t alone_mispredictions = 0;
+  printf("%-24s %10s %9s %9s %13s\n", "Trace", "Branches", "Alone", "Shared", "Interference");
+  for (int i = 0; i < num_traces; ++i) {
+    struct TraceStream *trace = &traces[i];
+    const char *name = strrchr(trace->path, '/') ? strrchr(trace->path, '/') + 1 : trace->path;
+    float alone_rate = trace->count ? 100*((float)trace->alone_mispredictions / (float)trace->count) : 0;
+    float shared_rate = trace->count ? 100*((float)trace->shared_mispredictions / (float)trace->count) : 0;
+    printf("%-24s %10d %9.3f %9.3f %+13.3f\n", name, trace->count, alone_rate, shared_rate, shared_rate - alone_rate);
+
+    num_branches += trace->count;
+    mispredictions += trace->shared_mispredictions;
+    alone_mispredictions += trace->alone_mispredictions;
+    predicted_taken += trace->shared_predicted_taken;
+  }
+
+  // Cost of every trace while interleaved
+  if (costModel) {
+    printf("%-24s %14s %9s %9s\n", "Trace", "Cycles", "CPI", "MPKI");
+    for (int i = 0; i < num_traces; ++i) {
+      struct TraceStream *trace = &traces[i];
+      const char *name = strrchr(trace->path, '/') ? strrchr(trace->path, '/') + 1 : trace->path;
+      double instructions = (double)trace->count * instsPerBranch;
+      double cycles = estimate_cycles(trace->count, trace->shared_mispredictions, trace->shared_predicted_taken);
+      printf("%-24s %14.0f %9.3f %9.3f\n", name, cycles,
+             instructions > 0 ? cycles / instructions : 0,
+             instructions > 0 ? 1000.0 * trace->shared_mispredictions / instructions : 0);
+    }
+  }
+
+  printf("Branches:        %10d\n", num_branches);
+  printf("Incorrect:       %10d\n", mispredictions);
+  float mispredict_rate = 100*((float)mispredictions / (float)num_branches);
+  printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+  printf("Ns/branch:       %10.3f\n", run_ns_per_branch(&shared));
+  printf("Alone ns/branch: %10.3f\n", run_ns_per_branch(&alone));
+  printf("Context Switches:%10d\n", switches);
+  printf("Interference:    %10d\n", (int)mispredictions - (int)alone_mispredictions);
+  float interference_rate = 100*(((float)mispredictions - (float)alone_mispredictions) / (float)num_branches);
+  printf("Interference Rate:  %7.3f\n", interference_rate);
+  print_predictor_stats();
+  if (costModel) {
+    print_cost_model(num_branches, mispredictions, predicted_taken);
+  }
+
+  // Cleanup
+  gc_predictor();
+  for (int i = 0; i < num_traces; ++i) {
+    free(traces[i].pcs);
+    free(traces[i].outcomes);
+    free(traces[i].history);
+  }
+
+  return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
   // Set defaults
   stream = stdin;
   bpType = STATIC;
+  filterBits = 0;
   verbose = 0;
+  costModel = 0;
+  pipelineDepth = 14;
+  mispredictPenalty = 0;
+  baseCPI = 1.0;
+  instsPerBranch = 5.0;
+  quantum = 10000;
+  asidHashing = 0;
+  saveHistory = 0;
+  char *trace_paths[MAX_TRACES];
+  int num_traces = 0;
 
   // Process cmdline Arguments
   for (int i = 1; i < argc; ++i) {
@@ -96,46 +566,87 @@ main(int argc, char *argv[])
         usage();
         exit(1);
       }
-    } else {
+    } else if (num_traces < MAX_TRACES) {
       // Use as input file
-      stream = fopen(argv[i], "r");
+      trace_paths[num_traces++] = argv[i];
+    } else {
+      fprintf(stderr,"At most %d traces can be interleaved\n", MAX_TRACES);
+      exit(1);
+    }
+  }
+
+  timerOverhead = get_timer_overhead_ns();
+
+  // Several traces share one predictor
+  if (num_traces > 1) {
+    if (quantum <= 0) {
+      fprintf(stderr,"Invalid quantum %d\n", quantum);
+      exit(1);
+    }
+    return run_multiprogrammed(trace_paths, num_traces);
+  }
+  int compressed = 0;
+  if (num_traces == 1) {
+    stream = open_trace_file(trace_paths[0], &compressed);
+    if (stream == NULL) {
+      fprintf(stderr,"Could not read trace %s\n", trace_paths[0]);
+      exit(1);
+    }
+  }
+
+  // With a bias filter the trace is kept in memory, so it can be run again
+  // without the filter and the time saved measured end to end
+  struct TraceStream recorded;
+  memset(&recorded, 0, sizeof(recorded));
+  if (filterBits > 0) {
+    read_trace_file(&recorded, stream);
+    if (recorded.failed) {
+      fprintf(stderr,"Out of memory reading trace\n");
+      exit(1);
     }
   }
 
   // Initialize the predictor
   init_predictor();
 
-  uint32_t num_branches = 0;
-  uint32_t mispredictions = 0;
+  struct RunStats stats;
+  memset(&stats, 0, sizeof(stats));
   uint32_t pc = 0;
   uint8_t outcome = NOTTAKEN;
 
   // Reach each branch from the trace
-  while (read_branch(&pc, &outcome)) {
-    num_branches++;
-
-    // Make a prediction and compare with actual outcome
-    uint8_t prediction = make_prediction(pc);
-    if (prediction != outcome) {
-      mispredictions++;
-    }
+  while (next_branch(&recorded, &pc, &outcome)) {
+    uint8_t prediction = run_branch(&stats, pc, outcome);
     if (verbose != 0) {
       printf ("%d\n", prediction);
     }
+  }
 
-    // Train the predictor
-    train_predictor(pc, outcome);
+  // bunzip2 failures only show up once the stream is closed
+  int failed = close_trace_file(stream, compressed);
+  if (failed || stats.num_branches == 0) {
+    fprintf(stderr,"Could not read trace %s\n", num_traces == 1 ? trace_paths[0] : "from stdin");
+    exit(1);
   }
 
   // Print out the mispredict statistics
-  printf("Branches:        %10d\n", num_branches);
-  printf("Incorrect:       %10d\n", mispredictions);
-  float mispredict_rate = 100*((float)mispredictions / (float)num_branches);
+  printf("Branches:        %10d\n", stats.num_branches);
+  printf("Incorrect:       %10d\n", stats.mispredictions);
+  float mispredict_rate = 100*((float)stats.mispredictions / (float)stats.num_branches);
   printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+  printf("Ns/branch:       %10.3f\n", run_ns_per_branch(&stats));
+  print_predictor_stats();
+  if (filterBits > 0) {
+    print_filter_saving(&recorded, run_ns_per_branch(&stats));
+  }
+  if (costModel) {
+    print_cost_model(stats.num_branches, stats.mispredictions, stats.predicted_taken);
+  }
 
   // Cleanup
-  fclose(stream);
   free(buf);
+  free(recorded.pcs);
+  free(recorded.outcomes);
 
   return 0;
 }
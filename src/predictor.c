@@ -5,10 +5,21 @@
 //  Implement the various branch predictors below as      //
 //  described in the README                               //
 //========================================================//
+#define _GNU_SOURCE
 #include <stdio.h>
 #include "predictor.h"
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// AVX2 gathers are compiled for x86 regardless of -m flags and only used when the CPU has them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HASHED_AVX2 1
+#endif
 
 const char *studentName = "Arpit Gupta";
 const char *studentID   = "A59010899";
@@ -19,14 +30,25 @@ const char *email       = "arg005@ucsd.edu";
 //------------------------------------//
 
 // Handy Global for use in output routines
-const char *bpName[4] = { "Static", "Gshare",
-                          "Tournament", "Custom" };
+const char *bpName[6] = { "Static", "Gshare",
+                          "Tournament", "Custom", "TAGE", "Hashed" };
 
 int ghistoryBits; // Number of bits used for Global History
 int lhistoryBits; // Number of bits used for Local History
 int pcIndexBits;  // Number of bits used for PC index
+int tageTables;   // Number of tagged TAGE tables
+int tageIndexBits; // Number of bits used to index each tagged TAGE table
+int tageTagBits;  // Number of tag bits in each tagged TAGE entry
+int tageMinHistory; // History length of the shortest tagged TAGE table
+int tageMaxHistory; // History length of the longest tagged TAGE table
+int hashedTables; // Number of hashed perceptron weight tables
+int hashedIndexBits; // Number of bits used to index each hashed perceptron table
+int hashedMinHistory; // History length covered by the first hashed perceptron segment
+int hashedMaxHistory; // History length covered by all hashed perceptron segments
+int filterBits;   // Number of bits used for bias filter index (0 disables it)
 int bpType;       // Branch Prediction Type
 int verbose;
+int sizesReported; // Sizes are only printed by the first init_predictor()
 
 #define max(a,b) ((a) > (b) ? (a) : (b))
 #define min(a,b) ((a) < (b) ? (a) : (b))
@@ -63,6 +85,34 @@ uint32_t get_mask(int number_of_ones)
   return mask;
 }
 
+uint64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Estimate the cost of a pair of timer reads so it can be removed from timing samples.
+uint64_t get_timer_overhead_ns()
+{
+  uint64_t overhead = UINT64_MAX;
+  for (int i = 0; i < 1000; i++)
+  {
+    uint64_t start = get_time_ns();
+    overhead = min(overhead, get_time_ns() - start);
+  }
+  return overhead;
+}
+
+// Warn when a predictor does not fit in the (64K + 256) bits allowed for the custom predictor.
+void check_predictor_budget(int sizeBits)
+{
+  if (sizeBits > CUSTOM_BUDGET_BITS)
+  {
+    fprintf(stderr, "Warning: predictor uses %d bits, over the budget of %d bits\n", sizeBits, CUSTOM_BUDGET_BITS);
+  }
+}
+
 
 //
 //TODO: Add your own Branch Predictor data structures here
@@ -139,6 +189,12 @@ void train_gshare_predictor(struct GSharePredictor *gsharePredictor, uint32_t pc
 
 }
 
+// Shift `outcome` into the history without training any counter.
+void update_history_gshare_predictor(struct GSharePredictor *gsharePredictor, uint8_t outcome)
+{
+  gsharePredictor->ghistory = ((gsharePredictor->ghistory << 1) | outcome) % (1 << gsharePredictor->ghistoryBits);
+}
+
 
 struct TournamentPredictor
 {
@@ -350,6 +406,14 @@ void train_tournament_predictor(struct TournamentPredictor *tournamentPredictor,
     // print_all_the_bits_after_consecutive_zeros(tournamentPredictor->ghistory);
   }
 }
+
+// Shift `outcome` into the local and global histories without training any counter.
+void update_history_tournament_predictor(struct TournamentPredictor *tournamentPredictor, uint32_t pc, uint8_t outcome)
+{
+  uint32_t *localHistory = &tournamentPredictor->localHistoryTable[pc % (1 << tournamentPredictor->pcIndexBits)];
+  *localHistory = ((*localHistory << 1) | outcome) % (1 << tournamentPredictor->lhistoryBits);
+  tournamentPredictor->ghistory = ((tournamentPredictor->ghistory << 1) | outcome) % (1 << tournamentPredictor->ghistoryBits);
+}
 //
 
 struct CustomPredictor {
@@ -379,7 +443,10 @@ void init_custom_predictor(struct CustomPredictor *customPredictor)
   }
 
   int perceptronsMemory = nPerceptrons * (nWeights + 1) * (CUSTOM_WEIGHTS_BITS + 1);
-  printf("Size of the predictor is %d bits + %lu\n", perceptronsMemory, sizeof(uint64_t) * 4);
+  if (!sizesReported) {
+    printf("Size of the predictor is %d bits + %lu\n", perceptronsMemory, sizeof(uint64_t) * 4);
+    check_predictor_budget(perceptronsMemory + sizeof(uint64_t) * 4);
+  }
 }
 
 int32_t make_prediction_custom_predictor_raw(struct CustomPredictor *customPredictor, uint32_t pc)
@@ -452,9 +519,819 @@ void train_custom_predictor(struct CustomPredictor *customPredictor, uint32_t pc
   customPredictor->ghistory = ((customPredictor->ghistory << 1) | outcome) % ((uint64_t) 1 << ghistoryBits);
 }
 
+void gc_custom_predictor(struct CustomPredictor *customPredictor)
+{
+  for (int i = 0; i < (1 << CUSTOM_PC_INDEX_BITS); ++i)
+  {
+    free(customPredictor->perceptrons[i]);
+  }
+  free(customPredictor->perceptrons);
+}
+
+// Shift `outcome` into the history without training any perceptron.
+void update_history_custom_predictor(struct CustomPredictor *customPredictor, uint8_t outcome)
+{
+  customPredictor->ghistory = ((customPredictor->ghistory << 1) | outcome) % ((uint64_t) 1 << ghistoryBits);
+}
+
+// Circular global history of arbitrary length.
+// Bits are packed into 64-bit words; age 0 is the most recent outcome.
+struct HistoryBuffer
+{
+    // Size: TAGE_HISTORY_BUFFER_BITS bits
+    uint64_t words[TAGE_HISTORY_BUFFER_BITS / 64];
+    uint32_t head;
+};
+
+void init_history_buffer(struct HistoryBuffer *historyBuffer)
+{
+  memset(historyBuffer->words, 0, sizeof(historyBuffer->words));
+  historyBuffer->head = 0;
+}
+
+uint8_t get_history_buffer_bit(const struct HistoryBuffer *historyBuffer, uint32_t age)
+{
+  uint32_t position = (historyBuffer->head + age) & (TAGE_HISTORY_BUFFER_BITS - 1);
+  return (historyBuffer->words[position >> 6] >> (position & 63)) & 1;
+}
+
+void push_history_buffer(struct HistoryBuffer *historyBuffer, uint8_t outcome)
+{
+  historyBuffer->head = (historyBuffer->head - 1) & (TAGE_HISTORY_BUFFER_BITS - 1);
+  uint64_t *word = &historyBuffer->words[historyBuffer->head >> 6];
+  uint64_t bit = (uint64_t) 1 << (historyBuffer->head & 63);
+  *word = outcome ? (*word | bit) : (*word & ~bit);
+}
+
+// The most recent `historyLength` bits of a HistoryBuffer XOR-folded down to `foldedLength` bits.
+// Updated in O(1) per branch: shift in the new bit, cancel the bit that leaves the window,
+// and wrap the overflow bit back to position 0.
+struct FoldedHistory
+{
+    uint32_t value;
+    uint32_t mask;
+    int historyLength;
+    int foldedLength;
+    int outPoint;
+};
+
+void init_folded_history(struct FoldedHistory *foldedHistory, int historyLength, int foldedLength)
+{
+  foldedHistory->value = 0;
+  foldedHistory->mask = get_mask(foldedLength);
+  foldedHistory->historyLength = historyLength;
+  foldedHistory->foldedLength = foldedLength;
+  foldedHistory->outPoint = historyLength % foldedLength;
+}
+
+// Must be called right after the new outcome was pushed to `historyBuffer`.
+void update_folded_history(struct FoldedHistory *foldedHistory, const struct HistoryBuffer *historyBuffer)
+{
+  uint32_t newest = get_history_buffer_bit(historyBuffer, 0);
+  uint32_t leaving = get_history_buffer_bit(historyBuffer, foldedHistory->historyLength);
+  uint32_t value = (foldedHistory->value << 1) | newest;
+  value ^= leaving << foldedHistory->outPoint;
+  value ^= value >> foldedHistory->foldedLength;
+  foldedHistory->value = value & foldedHistory->mask;
+}
+
+// TAGE: a bimodal base predictor backed by `tageTables` tagged tables indexed with
+// geometrically increasing global history lengths. The longest matching table provides
+// the prediction.
+//
+// Tagged entries are 4 bytes, so reading one never spans two cache lines; a lookup
+// touches one line per tagged table plus one for the base predictor.
+struct TageEntry
+{
+    uint16_t tag;
+    int8_t counter; // TAGE_COUNTER_BITS signed counter, predict taken when >= 0
+    uint8_t useful; // TAGE_USEFUL_BITS counter
+};
+
+struct TagePredictor
+{
+    int pcIndexBits;
+    int nTables;
+    int indexBits;
+    int tagBits;
+
+    // Base predictor.
+    // Size: 2^pcIndexBits (each entry is 2 bits, same encoding as gshare)
+    uint8_t *basePrediction;
+
+    // Tagged tables.
+    // Size: nTables * 2^indexBits (each entry is tagBits + TAGE_COUNTER_BITS + TAGE_USEFUL_BITS bits)
+    struct TageEntry *tables[TAGE_MAX_TABLES];
+    int historyLengths[TAGE_MAX_TABLES];
+    uint32_t pathMasks[TAGE_MAX_TABLES]; // Path history bits used by each table
+
+    // Global and path history.
+    struct HistoryBuffer ghistory;
+    uint32_t phistory;
+    struct FoldedHistory indexHistory[TAGE_MAX_TABLES];
+    struct FoldedHistory tagHistory[TAGE_MAX_TABLES][2];
+
+    // Chooses between the provider and the alternate prediction when the provider is newly allocated.
+    int8_t useAltOnNewlyAllocated;
+
+    uint32_t branches;
+    uint32_t random;
+
+    // Lookup state, computed once by make_prediction and reused by train.
+    uint32_t lookupPc;
+    uint8_t lookupValid;
+    uint32_t indices[TAGE_MAX_TABLES];
+    uint16_t tags[TAGE_MAX_TABLES];
+    int provider;        // Longest matching table, -1 for the base predictor
+    int alternate;       // Second longest matching table, -1 for the base predictor
+    uint8_t providerPrediction;
+    uint8_t alternatePrediction;
+    uint8_t prediction;
+};
+
+void init_tage_predictor(struct TagePredictor *tagePredictor, int pcIndexBits, int nTables, int indexBits, int tagBits, int minHistory, int maxHistory)
+{
+  assert(pcIndexBits > 0 && pcIndexBits <= 24);
+  assert(nTables > 0 && nTables <= TAGE_MAX_TABLES);
+  assert(indexBits > 0 && indexBits <= 24);
+  assert(tagBits > 1 && tagBits <= 16);
+  assert(minHistory > 0 && minHistory <= maxHistory && maxHistory < TAGE_HISTORY_BUFFER_BITS);
+
+  tagePredictor->pcIndexBits = pcIndexBits;
+  tagePredictor->nTables = nTables;
+  tagePredictor->indexBits = indexBits;
+  tagePredictor->tagBits = tagBits;
+
+  // Initialize the base prediction table.
+  uint32_t basePredictionSize = (1 << pcIndexBits); // 2^pcIndexBits
+  tagePredictor->basePrediction = (uint8_t *) malloc(basePredictionSize * sizeof(uint8_t));
+  assert(tagePredictor->basePrediction != NULL);
+  for (int i = 0; i < basePredictionSize; i++) { tagePredictor->basePrediction[i] = WN; }
+
+  // Initialize the tagged tables with geometric history lengths.
+  init_history_buffer(&tagePredictor->ghistory);
+  tagePredictor->phistory = 0;
+  uint32_t tableSize = (1 << indexBits); // 2^indexBits
+  for (int i = 0; i < nTables; i++)
+  {
+    tagePredictor->tables[i] = (struct TageEntry *) malloc(tableSize * sizeof(struct TageEntry));
+    assert(tagePredictor->tables[i] != NULL);
+    memset(tagePredictor->tables[i], 0, tableSize * sizeof(struct TageEntry));
+
+    double ratio = nTables > 1 ? (double) i / (nTables - 1) : 0;
+    int historyLength = (int) (minHistory * pow((double) maxHistory / minHistory, ratio) + 0.5);
+    if (i > 0) { historyLength = max(historyLength, tagePredictor->historyLengths[i - 1] + 1); }
+    tagePredictor->historyLengths[i] = historyLength;
+    tagePredictor->pathMasks[i] = get_mask(min(historyLength, TAGE_PATH_HISTORY_BITS));
+
+    init_folded_history(&tagePredictor->indexHistory[i], historyLength, indexBits);
+    init_folded_history(&tagePredictor->tagHistory[i][0], historyLength, tagBits);
+    init_folded_history(&tagePredictor->tagHistory[i][1], historyLength, tagBits - 1);
+  }
+
+  tagePredictor->useAltOnNewlyAllocated = 0;
+  tagePredictor->branches = 0;
+  tagePredictor->random = 0x2545F491;
+  tagePredictor->lookupValid = 0;
+
+  int baseMemory = basePredictionSize * 2;
+  int tablesMemory = nTables * tableSize * (tagBits + TAGE_COUNTER_BITS + TAGE_USEFUL_BITS);
+  int registersMemory = tagePredictor->historyLengths[nTables - 1] + TAGE_PATH_HISTORY_BITS + TAGE_USE_ALT_BITS + nTables * (indexBits + 2 * tagBits - 1);
+  if (!sizesReported) {
+    printf("Size of the predictor is %d bits + %d\n", baseMemory + tablesMemory, registersMemory);
+    check_predictor_budget(baseMemory + tablesMemory + registersMemory);
+  }
+}
+
+void gc_tage_predictor(struct TagePredictor *tagePredictor)
+{
+  free(tagePredictor->basePrediction);
+  for (int i = 0; i < tagePredictor->nTables; i++)
+  {
+    free(tagePredictor->tables[i]);
+  }
+}
+
+void lookup_tage_predictor(struct TagePredictor *tagePredictor, uint32_t pc)
+{
+  uint32_t indexMask = get_mask(tagePredictor->indexBits);
+  uint32_t tagMask = get_mask(tagePredictor->tagBits);
+
+  tagePredictor->provider = -1;
+  tagePredictor->alternate = -1;
+  for (int i = 0; i < tagePredictor->nTables; i++)
+  {
+    uint32_t path = tagePredictor->phistory & tagePredictor->pathMasks[i];
+    uint32_t index = pc ^ (pc >> (tagePredictor->indexBits - i % tagePredictor->indexBits)) ^ tagePredictor->indexHistory[i].value ^ path;
+    uint32_t tag = pc ^ tagePredictor->tagHistory[i][0].value ^ (tagePredictor->tagHistory[i][1].value << 1);
+    tagePredictor->indices[i] = index & indexMask;
+    tagePredictor->tags[i] = tag & tagMask;
+  }
+
+  // Find the two longest matching tables.
+  for (int i = tagePredictor->nTables - 1; i >= 0; i--)
+  {
+    if (tagePredictor->tables[i][tagePredictor->indices[i]].tag == tagePredictor->tags[i])
+    {
+      if (tagePredictor->provider < 0)
+      {
+        tagePredictor->provider = i;
+      }
+      else
+      {
+        tagePredictor->alternate = i;
+        break;
+      }
+    }
+  }
+
+  uint8_t baseCounter = tagePredictor->basePrediction[pc & get_mask(tagePredictor->pcIndexBits)];
+  uint8_t basePrediction = ((baseCounter >> 1) & 1) == 1 ? TAKEN : NOTTAKEN;
+
+  tagePredictor->alternatePrediction = tagePredictor->alternate >= 0
+    ? (tagePredictor->tables[tagePredictor->alternate][tagePredictor->indices[tagePredictor->alternate]].counter >= 0 ? TAKEN : NOTTAKEN)
+    : basePrediction;
+
+  if (tagePredictor->provider < 0)
+  {
+    tagePredictor->providerPrediction = basePrediction;
+    tagePredictor->prediction = basePrediction;
+  }
+  else
+  {
+    struct TageEntry *entry = &tagePredictor->tables[tagePredictor->provider][tagePredictor->indices[tagePredictor->provider]];
+    tagePredictor->providerPrediction = entry->counter >= 0 ? TAKEN : NOTTAKEN;
+
+    // Newly allocated entries (weak counter, not yet useful) are often less accurate than the alternate.
+    uint8_t newlyAllocated = (entry->counter == 0 || entry->counter == -1) && entry->useful == 0;
+    tagePredictor->prediction = newlyAllocated && tagePredictor->useAltOnNewlyAllocated >= 0
+      ? tagePredictor->alternatePrediction
+      : tagePredictor->providerPrediction;
+  }
+
+  tagePredictor->lookupPc = pc;
+  tagePredictor->lookupValid = 1;
+}
+
+uint8_t make_prediction_tage_predictor(struct TagePredictor *tagePredictor, uint32_t pc)
+{
+  lookup_tage_predictor(tagePredictor, pc);
+  return tagePredictor->prediction;
+}
+
+int8_t update_signed_counter(int8_t counter, int8_t increment, int bits)
+{
+  int8_t limit = 1 << (bits - 1);
+  return min(max(counter + increment, -limit), limit - 1);
+}
+
+uint32_t next_tage_random(struct TagePredictor *tagePredictor)
+{
+  // xorshift32
+  uint32_t x = tagePredictor->random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  tagePredictor->random = x;
+  return x;
+}
+
+// Shift `outcome` into the global, path and folded histories.
+void update_history_tage_predictor(struct TagePredictor *tagePredictor, uint32_t pc, uint8_t outcome)
+{
+  push_history_buffer(&tagePredictor->ghistory, outcome);
+  tagePredictor->phistory = ((tagePredictor->phistory << 1) | (pc & 1)) & get_mask(TAGE_PATH_HISTORY_BITS);
+  for (int i = 0; i < tagePredictor->nTables; i++)
+  {
+    update_folded_history(&tagePredictor->indexHistory[i], &tagePredictor->ghistory);
+    update_folded_history(&tagePredictor->tagHistory[i][0], &tagePredictor->ghistory);
+    update_folded_history(&tagePredictor->tagHistory[i][1], &tagePredictor->ghistory);
+  }
+  tagePredictor->lookupValid = 0;
+}
+
+void train_tage_predictor(struct TagePredictor *tagePredictor, uint32_t pc, uint8_t outcome)
+{
+  if (!tagePredictor->lookupValid || tagePredictor->lookupPc != pc)
+  {
+    lookup_tage_predictor(tagePredictor, pc);
+  }
+
+  int provider = tagePredictor->provider;
+  int8_t increment = outcome == TAKEN ? 1 : -1;
+
+  // Allocate a longer-history entry on a misprediction.
+  if (tagePredictor->prediction != outcome && provider < tagePredictor->nTables - 1)
+  {
+    int allocated = 0;
+    // Skip one candidate at random so allocations spread over the longer tables.
+    int start = provider + 1 + ((next_tage_random(tagePredictor) & 3) == 0 ? 1 : 0);
+    for (int i = min(start, tagePredictor->nTables - 1); i < tagePredictor->nTables; i++)
+    {
+      struct TageEntry *entry = &tagePredictor->tables[i][tagePredictor->indices[i]];
+      if (entry->useful == 0)
+      {
+        entry->tag = tagePredictor->tags[i];
+        entry->counter = outcome == TAKEN ? 0 : -1;
+        allocated = 1;
+        break;
+      }
+    }
+    if (!allocated)
+    {
+      for (int i = provider + 1; i < tagePredictor->nTables; i++)
+      {
+        struct TageEntry *entry = &tagePredictor->tables[i][tagePredictor->indices[i]];
+        entry->useful = entry->useful > 0 ? entry->useful - 1 : 0;
+      }
+    }
+  }
+
+  if (provider >= 0)
+  {
+    struct TageEntry *entry = &tagePredictor->tables[provider][tagePredictor->indices[provider]];
+
+    // Learn whether newly allocated providers should be trusted.
+    uint8_t newlyAllocated = (entry->counter == 0 || entry->counter == -1) && entry->useful == 0;
+    if (newlyAllocated && tagePredictor->providerPrediction != tagePredictor->alternatePrediction)
+    {
+      tagePredictor->useAltOnNewlyAllocated = update_signed_counter(tagePredictor->useAltOnNewlyAllocated,
+        tagePredictor->alternatePrediction == outcome ? 1 : -1, TAGE_USE_ALT_BITS);
+    }
+
+    // The provider is useful when it was right and the alternate was not.
+    if (tagePredictor->providerPrediction != tagePredictor->alternatePrediction)
+    {
+      int8_t usefulIncrement = tagePredictor->providerPrediction == outcome ? 1 : -1;
+      entry->useful = min(max(entry->useful + usefulIncrement, 0), (int) get_mask(TAGE_USEFUL_BITS));
+    }
+
+    entry->counter = update_signed_counter(entry->counter, increment, TAGE_COUNTER_BITS);
+  }
+  else
+  {
+    uint8_t *baseCounter = &tagePredictor->basePrediction[pc & get_mask(tagePredictor->pcIndexBits)];
+    *baseCounter = update_counter(*baseCounter, increment);
+  }
+
+  // Periodically age the useful bits so stale entries can be replaced.
+  tagePredictor->branches++;
+  if (tagePredictor->branches % TAGE_USEFUL_RESET_PERIOD == 0)
+  {
+    uint32_t tableSize = (1 << tagePredictor->indexBits);
+    for (int i = 0; i < tagePredictor->nTables; i++)
+    {
+      for (int j = 0; j < tableSize; j++) { tagePredictor->tables[i][j].useful >>= 1; }
+    }
+  }
+
+  update_history_tage_predictor(tagePredictor, pc, outcome);
+}
+
+// Hashed perceptron: HASHED_MAX_TABLES small weight tables, each indexed by a hash of the
+// PC with a different segment of the global history plus the path history. Table 0 only
+// sees the PC and acts as the bias weight; table i covers the history bits between the
+// geometric lengths of tables i - 1 and i. The prediction is the sign of the sum of
+// the selected weights.
+struct HashedPredictor
+{
+    int nTables;
+    int indexBits;
+
+    // Weight tables, stored back to back (table i starts at i * 2^indexBits).
+    // Size: nTables * 2^indexBits (each weight is HASHED_WEIGHTS_BITS bits)
+    int8_t *weights;
+    int32_t historyLengths[HASHED_MAX_TABLES]; // 0 for table 0 and missing tables
+    uint32_t tableOffsets[HASHED_MAX_TABLES];  // i * 2^indexBits
+    int32_t tableLanes[HASHED_MAX_TABLES];     // -1 for tables that exist
+    uint16_t indexMask;
+    uint8_t useGather;                         // Gather with AVX2 instead of scalar loads
+    // Per-table index hash constants, one 16-bit lane per table.
+    uint16_t pcMultipliers[HASHED_MAX_TABLES];   // 2 * i + 1
+    uint16_t pathMasks[HASHED_MAX_TABLES];       // Path history bits used by each table
+    uint16_t pathMultipliers[HASHED_MAX_TABLES]; // 1 << (i % indexBits)
+    uint16_t historyLanes[HASHED_MAX_TABLES];    // 0xFFFF for tables that use global history
+    uint16_t outPoints[HASHED_MAX_TABLES];       // historyLength % indexBits
+
+    // Global and path history.
+    // Every table folds its history prefix to the same indexBits width, so a fold update is
+    // the same rotate for all tables and is done on the whole array at once
+    // (see struct FoldedHistory for the single register version used by TAGE).
+    struct HistoryBuffer ghistory;
+    uint32_t phistory;
+    uint16_t foldedHistory[HASHED_MAX_TABLES];
+
+    // Adaptive training threshold.
+    int32_t theta;
+    int32_t thetaCounter;
+
+    // Lookup state, computed once by make_prediction and reused by train.
+    uint32_t lookupPc;
+    uint8_t lookupValid;
+    uint32_t indices[HASHED_MAX_TABLES]; // Offsets into weights
+    int32_t output;
+};
+
+void init_hashed_predictor(struct HashedPredictor *hashedPredictor, int nTables, int indexBits, int minHistory, int maxHistory)
+{
+  assert(nTables > 1 && nTables <= HASHED_MAX_TABLES);
+  assert(indexBits > 0 && indexBits <= 16);
+  assert(minHistory > 0 && minHistory <= maxHistory && maxHistory < TAGE_HISTORY_BUFFER_BITS);
+
+  hashedPredictor->nTables = nTables;
+  hashedPredictor->indexBits = indexBits;
+
+  // Initialize the weight tables. A gather reads 4 bytes per weight, so pad the end.
+  uint32_t tableSize = (1 << indexBits); // 2^indexBits
+  void *weights = NULL;
+  int failed = posix_memalign(&weights, 64, nTables * tableSize * sizeof(int8_t) + sizeof(int32_t));
+  assert(!failed && weights != NULL);
+  hashedPredictor->weights = (int8_t *) weights;
+  memset(weights, 0, nTables * tableSize * sizeof(int8_t) + sizeof(int32_t));
+  hashedPredictor->indexMask = get_mask(indexBits);
+#if defined(HASHED_AVX2)
+  __builtin_cpu_init();
+  hashedPredictor->useGather = __builtin_cpu_supports("avx2") != 0;
+#else
+  hashedPredictor->useGather = 0;
+#endif
+
+  init_history_buffer(&hashedPredictor->ghistory);
+  hashedPredictor->phistory = 0;
+  memset(hashedPredictor->historyLengths, 0, sizeof(hashedPredictor->historyLengths));
+  memset(hashedPredictor->outPoints, 0, sizeof(hashedPredictor->outPoints));
+  for (int i = 0; i < nTables; i++)
+  {
+    if (i > 0)
+    {
+      double ratio = nTables > 2 ? (double) (i - 1) / (nTables - 2) : 0;
+      int historyLength = (int) (minHistory * pow((double) maxHistory / minHistory, ratio) + 0.5);
+      historyLength = max(historyLength, hashedPredictor->historyLengths[i - 1] + 1);
+      hashedPredictor->historyLengths[i] = historyLength;
+    }
+    hashedPredictor->outPoints[i] = hashedPredictor->historyLengths[i] % indexBits;
+  }
+
+  // Lanes of missing tables hash to 0 and their weights are never read.
+  memset(hashedPredictor->tableOffsets, 0, sizeof(hashedPredictor->tableOffsets));
+  memset(hashedPredictor->tableLanes, 0, sizeof(hashedPredictor->tableLanes));
+  memset(hashedPredictor->pcMultipliers, 0, sizeof(hashedPredictor->pcMultipliers));
+  memset(hashedPredictor->pathMasks, 0, sizeof(hashedPredictor->pathMasks));
+  memset(hashedPredictor->pathMultipliers, 0, sizeof(hashedPredictor->pathMultipliers));
+  memset(hashedPredictor->historyLanes, 0, sizeof(hashedPredictor->historyLanes));
+  memset(hashedPredictor->foldedHistory, 0, sizeof(hashedPredictor->foldedHistory));
+  for (int i = 0; i < nTables; i++)
+  {
+    hashedPredictor->tableOffsets[i] = (uint32_t) i << indexBits;
+    hashedPredictor->tableLanes[i] = -1;
+    hashedPredictor->pcMultipliers[i] = 2 * i + 1;
+    hashedPredictor->pathMasks[i] = get_mask(min(hashedPredictor->historyLengths[i], TAGE_PATH_HISTORY_BITS));
+    hashedPredictor->pathMultipliers[i] = 1 << (i % indexBits);
+    hashedPredictor->historyLanes[i] = i > 0 ? 0xFFFF : 0;
+  }
+
+  hashedPredictor->theta = (int32_t) (1.93 * nTables + 14);
+  hashedPredictor->thetaCounter = 0;
+  hashedPredictor->lookupValid = 0;
+
+  int weightsMemory = nTables * tableSize * HASHED_WEIGHTS_BITS;
+  int registersMemory = hashedPredictor->historyLengths[nTables - 1] + TAGE_PATH_HISTORY_BITS + HASHED_THETA_BITS + nTables * indexBits;
+  if (!sizesReported) {
+    printf("Size of the predictor is %d bits + %d\n", weightsMemory, registersMemory);
+    check_predictor_budget(weightsMemory + registersMemory);
+  }
+}
+
+void gc_hashed_predictor(struct HashedPredictor *hashedPredictor)
+{
+  free(hashedPredictor->weights);
+}
+
+// Sum of all HASHED_MAX_TABLES weight lanes.
+int32_t sum_hashed_predictor_lanes(const int8_t *lanes)
+{
+#if defined(__SSE2__) && HASHED_MAX_TABLES == 16
+  // Bias the signed weights to unsigned bytes so a single SAD against zero adds them up.
+  __m128i biased = _mm_xor_si128(_mm_loadu_si128((const __m128i *) lanes), _mm_set1_epi8((char) 0x80));
+  __m128i sums = _mm_sad_epu8(biased, _mm_setzero_si128());
+  return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4) - HASHED_MAX_TABLES * 128;
+#else
+  int32_t output = 0;
+  for (int i = 0; i < HASHED_MAX_TABLES; i++) { output += lanes[i]; }
+  return output;
+#endif
+}
+
+// Index of every table, in 16-bit lanes: the PC hash times an odd constant, XOR the global
+// history segment of the table, XOR its shifted path history.
+void hash_hashed_predictor_indices(struct HashedPredictor *hashedPredictor, uint32_t pcHash, uint16_t *indices)
+{
+  const uint16_t *folded = hashedPredictor->foldedHistory;
+  uint16_t indexMask = hashedPredictor->indexMask;
+#if defined(__SSE2__) && HASHED_MAX_TABLES == 16
+  __m128i pcs = _mm_set1_epi16((short) pcHash);
+  __m128i paths = _mm_set1_epi16((short) hashedPredictor->phistory);
+  __m128i mask = _mm_set1_epi16((short) indexMask);
+  for (int i = 0; i < HASHED_MAX_TABLES; i += 8)
+  {
+    // Folding is linear, so XOR-ing two prefixes of the history leaves the segment between them.
+    __m128i prefix = _mm_loadu_si128((const __m128i *) &folded[i]);
+    __m128i previous = i == 0 ? _mm_slli_si128(prefix, 2) : _mm_loadu_si128((const __m128i *) &folded[i - 1]);
+    __m128i segment = _mm_and_si128(_mm_xor_si128(prefix, previous),
+                                    _mm_loadu_si128((const __m128i *) &hashedPredictor->historyLanes[i]));
+    __m128i pcPart = _mm_mullo_epi16(pcs, _mm_loadu_si128((const __m128i *) &hashedPredictor->pcMultipliers[i]));
+    __m128i pathPart = _mm_mullo_epi16(_mm_and_si128(paths, _mm_loadu_si128((const __m128i *) &hashedPredictor->pathMasks[i])),
+                                       _mm_loadu_si128((const __m128i *) &hashedPredictor->pathMultipliers[i]));
+    __m128i index = _mm_and_si128(_mm_xor_si128(_mm_xor_si128(pcPart, segment), pathPart), mask);
+    _mm_storeu_si128((__m128i *) &indices[i], index);
+  }
+#else
+  for (int i = 0; i < HASHED_MAX_TABLES; i++)
+  {
+    uint16_t segment = (folded[i] ^ (i > 0 ? folded[i - 1] : 0)) & hashedPredictor->historyLanes[i];
+    uint16_t path = (hashedPredictor->phistory & hashedPredictor->pathMasks[i]) * hashedPredictor->pathMultipliers[i];
+    indices[i] = ((uint16_t) (pcHash * hashedPredictor->pcMultipliers[i]) ^ segment ^ path) & indexMask;
+  }
+#endif
+}
+
+#if defined(HASHED_AVX2)
+// Gather the weight of every table with two 8-lane AVX2 gathers and sum them.
+// Each lane reads the 4 bytes at its weight and keeps the sign-extended low byte.
+__attribute__((target("avx2")))
+int32_t gather_hashed_predictor_weights(struct HashedPredictor *hashedPredictor, const uint16_t *indices)
+{
+  const int *weights = (const int *) hashedPredictor->weights;
+  __m256i sums = _mm256_setzero_si256();
+  for (int i = 0; i < HASHED_MAX_TABLES; i += 8)
+  {
+    __m256i offsets = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) &indices[i])),
+                                       _mm256_loadu_si256((const __m256i *) &hashedPredictor->tableOffsets[i]));
+    _mm256_storeu_si256((__m256i *) &hashedPredictor->indices[i], offsets);
+    __m256i lanes = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), weights, offsets,
+                                                _mm256_loadu_si256((const __m256i *) &hashedPredictor->tableLanes[i]), 1);
+    sums = _mm256_add_epi32(sums, _mm256_srai_epi32(_mm256_slli_epi32(lanes, 24), 24));
+  }
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  int32_t output = _mm_cvtsi128_si32(sum);
+  // The rest of the file is plain SSE code; leave the upper halves clean so it does not stall.
+  _mm256_zeroupper();
+  return output;
+}
+#endif
+
+void lookup_hashed_predictor(struct HashedPredictor *hashedPredictor, uint32_t pc)
+{
+  uint16_t indices[HASHED_MAX_TABLES];
+  hash_hashed_predictor_indices(hashedPredictor, pc ^ (pc >> hashedPredictor->indexBits), indices);
+
+#if defined(HASHED_AVX2)
+  if (hashedPredictor->useGather)
+  {
+    hashedPredictor->output = gather_hashed_predictor_weights(hashedPredictor, indices);
+    hashedPredictor->lookupPc = pc;
+    hashedPredictor->lookupValid = 1;
+    return;
+  }
+#endif
+
+  // Work on locals: stores through int8_t pointers may alias any field of the predictor,
+  // which would force a reload of every field on each iteration.
+  const int8_t *weights = hashedPredictor->weights;
+  int nTables = hashedPredictor->nTables;
+  int8_t lanes[HASHED_MAX_TABLES] = { 0 };
+  for (int i = 0; i < nTables; i++)
+  {
+    uint32_t offset = hashedPredictor->tableOffsets[i] | indices[i];
+    hashedPredictor->indices[i] = offset;
+    lanes[i] = weights[offset];
+  }
+
+  hashedPredictor->output = sum_hashed_predictor_lanes(lanes);
+  hashedPredictor->lookupPc = pc;
+  hashedPredictor->lookupValid = 1;
+}
+
+uint8_t make_prediction_hashed_predictor(struct HashedPredictor *hashedPredictor, uint32_t pc)
+{
+  lookup_hashed_predictor(hashedPredictor, pc);
+  return hashedPredictor->output >= 0 ? TAKEN : NOTTAKEN;
+}
+
+#if defined(HASHED_AVX2)
+// Gather the bit leaving the history window of every table straight from the circular
+// buffer (read as 32-bit words) and move it to the table's folded position.
+__attribute__((target("avx2")))
+void gather_hashed_predictor_leaving_bits(struct HashedPredictor *hashedPredictor, uint16_t *leaving)
+{
+  const int *words = (const int *) hashedPredictor->ghistory.words;
+  __m256i head = _mm256_set1_epi32(hashedPredictor->ghistory.head);
+  __m256i wrap = _mm256_set1_epi32(TAGE_HISTORY_BUFFER_BITS - 1);
+  __m256i bitInWord = _mm256_set1_epi32(31);
+  for (int i = 0; i < HASHED_MAX_TABLES; i += 8)
+  {
+    __m256i positions = _mm256_and_si256(_mm256_add_epi32(head, _mm256_loadu_si256((const __m256i *) &hashedPredictor->historyLengths[i])), wrap);
+    __m256i bits = _mm256_i32gather_epi32(words, _mm256_srli_epi32(positions, 5), 4);
+    bits = _mm256_and_si256(_mm256_srlv_epi32(bits, _mm256_and_si256(positions, bitInWord)), _mm256_set1_epi32(1));
+    bits = _mm256_sllv_epi32(bits, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) &hashedPredictor->outPoints[i])));
+    _mm_storeu_si128((__m128i *) &leaving[i], _mm_packs_epi32(_mm256_castsi256_si128(bits), _mm256_extracti128_si256(bits, 1)));
+  }
+  _mm256_zeroupper();
+}
+#endif
+
+// Shift `outcome` into the global, path and folded histories.
+void update_history_hashed_predictor(struct HashedPredictor *hashedPredictor, uint32_t pc, uint8_t outcome)
+{
+  push_history_buffer(&hashedPredictor->ghistory, outcome);
+  hashedPredictor->phistory = ((hashedPredictor->phistory << 1) | ((pc >> 2) & 1)) & ((1 << TAGE_PATH_HISTORY_BITS) - 1);
+  // Bits leaving each table's history window, already moved to their folded position.
+  // Lanes without global history are cleared by historyLanes below.
+  uint16_t leaving[HASHED_MAX_TABLES] = { 0 };
+#if defined(HASHED_AVX2)
+  if (hashedPredictor->useGather)
+  {
+    gather_hashed_predictor_leaving_bits(hashedPredictor, leaving);
+  }
+  else
+#endif
+  {
+    int nTables = hashedPredictor->nTables;
+    for (int i = 1; i < nTables; i++)
+    {
+      leaving[i] = get_history_buffer_bit(&hashedPredictor->ghistory, hashedPredictor->historyLengths[i]) << hashedPredictor->outPoints[i];
+    }
+  }
+
+  // Rotate every register left by one within indexBits, then add the new bit and cancel the leaving one.
+  uint16_t *folded = hashedPredictor->foldedHistory;
+  int width = hashedPredictor->indexBits;
+  uint16_t mask = hashedPredictor->indexMask;
+#if defined(__SSE2__) && HASHED_MAX_TABLES == 16
+  __m128i newest = _mm_set1_epi16(outcome);
+  __m128i widthMask = _mm_set1_epi16(mask);
+  __m128i rotateIn = _mm_cvtsi32_si128(width - 1);
+  for (int i = 0; i < HASHED_MAX_TABLES; i += 8)
+  {
+    __m128i value = _mm_loadu_si128((const __m128i *) &folded[i]);
+    __m128i rotated = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(value, 1), _mm_srl_epi16(value, rotateIn)), widthMask);
+    value = _mm_xor_si128(_mm_xor_si128(rotated, newest), _mm_loadu_si128((const __m128i *) &leaving[i]));
+    value = _mm_and_si128(value, _mm_loadu_si128((const __m128i *) &hashedPredictor->historyLanes[i]));
+    _mm_storeu_si128((__m128i *) &folded[i], value);
+  }
+#else
+  for (int i = 0; i < HASHED_MAX_TABLES; i++)
+  {
+    uint16_t rotated = ((folded[i] << 1) | (folded[i] >> (width - 1))) & mask;
+    folded[i] = (rotated ^ outcome ^ leaving[i]) & hashedPredictor->historyLanes[i];
+  }
+#endif
+  hashedPredictor->lookupValid = 0;
+}
+
+void train_hashed_predictor(struct HashedPredictor *hashedPredictor, uint32_t pc, uint8_t outcome)
+{
+  if (!hashedPredictor->lookupValid || hashedPredictor->lookupPc != pc)
+  {
+    lookup_hashed_predictor(hashedPredictor, pc);
+  }
+
+  int32_t output = hashedPredictor->output;
+  uint8_t mispredicted = (output >= 0) != (outcome == TAKEN);
+  int32_t absMaxWeights = 1 << (HASHED_WEIGHTS_BITS - 1);
+
+  if (mispredicted || abs(output) <= hashedPredictor->theta)
+  {
+    int8_t increment = outcome == TAKEN ? 1 : -1;
+    int8_t *weights = hashedPredictor->weights;
+    int nTables = hashedPredictor->nTables;
+    uint32_t indices[HASHED_MAX_TABLES];
+    memcpy(indices, hashedPredictor->indices, sizeof(indices));
+    for (int i = 0; i < nTables; i++)
+    {
+      int8_t *weight = &weights[indices[i]];
+      *weight = max(min(*weight + increment, (absMaxWeights - 1)), -absMaxWeights);
+    }
+
+    // Adjust theta so mispredictions and low-confidence updates stay balanced.
+    int32_t thetaCounterMax = 1 << (HASHED_THETA_BITS - 1);
+    hashedPredictor->thetaCounter += mispredicted ? 1 : -1;
+    if (hashedPredictor->thetaCounter >= thetaCounterMax)
+    {
+      hashedPredictor->theta++;
+      hashedPredictor->thetaCounter = 0;
+    }
+    else if (hashedPredictor->thetaCounter <= -thetaCounterMax)
+    {
+      hashedPredictor->theta--;
+      hashedPredictor->thetaCounter = 0;
+    }
+  }
+
+  update_history_hashed_predictor(hashedPredictor, pc, outcome);
+}
+
+// Bias filter placed in front of any predictor mode.
+// Branches whose PC has produced the same outcome for the last
+// 2^FILTER_CONFIDENCE_BITS - 1 executions are predicted by the filter alone; the
+// backing predictor only sees their outcome in its history. Everything else is passed through.
+struct BiasFilter
+{
+    int filterBits;
+
+    // Filter entries.
+    // Size: 2^filterBits (each entry is 1 + FILTER_CONFIDENCE_BITS bits: bit 0 is the last
+    // outcome, the remaining bits count consecutive repeats of that outcome)
+    uint8_t *entries;
+
+    // Statistics.
+    uint64_t lookups;
+    uint64_t hits;
+};
+
+void init_bias_filter(struct BiasFilter *biasFilter, int filterBits)
+{
+  assert(filterBits > 0 && filterBits <= FILTER_MAX_BITS);
+  biasFilter->filterBits = filterBits;
+  biasFilter->lookups = 0;
+  biasFilter->hits = 0;
+
+  // Initialize the filter table (not taken, no confidence).
+  uint32_t entriesSize = (1 << filterBits); // 2^filterBits
+  biasFilter->entries = (uint8_t *) malloc(entriesSize * sizeof(uint8_t));
+  assert(biasFilter->entries != NULL);
+  for (int i = 0; i < entriesSize; i++) { biasFilter->entries[i] = 0; }
+
+  int filterMemory = entriesSize * (FILTER_CONFIDENCE_BITS + 1);
+  if (!sizesReported) {
+    printf("Size of the bias filter is %d bits\n", filterMemory);
+  }
+}
+
+void gc_bias_filter(struct BiasFilter *biasFilter)
+{
+  free(biasFilter->entries);
+}
+
+// Returns True if the branch at `pc` is confidently biased and stores the biased direction in `prediction`.
+uint8_t lookup_bias_filter(struct BiasFilter *biasFilter, uint32_t pc, uint8_t *prediction)
+{
+  uint8_t entry = biasFilter->entries[pc & get_mask(biasFilter->filterBits)];
+  uint8_t confidence = entry >> 1;
+
+  *prediction = entry & 1;
+  return confidence == get_mask(FILTER_CONFIDENCE_BITS);
+}
+
+void train_bias_filter(struct BiasFilter *biasFilter, uint32_t pc, uint8_t outcome)
+{
+  uint8_t *entry = &biasFilter->entries[pc & get_mask(biasFilter->filterBits)];
+  uint8_t direction = *entry & 1;
+  uint8_t confidence = *entry >> 1;
+
+  // Count repeats of the same outcome; any change of direction drops the branch back to the predictor.
+  if (direction == outcome)
+  {
+    confidence = min(confidence + 1, get_mask(FILTER_CONFIDENCE_BITS));
+  }
+  else
+  {
+    direction = outcome;
+    confidence = 0;
+  }
+  *entry = (confidence << 1) | direction;
+}
+
+void print_bias_filter_stats(struct BiasFilter *biasFilter)
+{
+  float hitRate = biasFilter->lookups ? (float) biasFilter->hits / biasFilter->lookups : 0;
+
+  printf("Filter hits:     %10lu\n", biasFilter->hits);
+  printf("Filter Hit Rate:    %7.3f\n", 100 * hitRate);
+}
+
+struct BiasFilter biasFilter;
 struct GSharePredictor gsharePredictor;
 struct TournamentPredictor tournamentPredictor;
 struct CustomPredictor customPredictor;
+struct TagePredictor tagePredictor;
+struct HashedPredictor hashedPredictor;
+
+// Global history registers of every predictor type, as saved on a context switch.
+// Per-PC state (local histories, tables, weights) stays shared between contexts.
+struct PredictorHistory
+{
+    uint32_t ghistory;   // gshare, tournament
+    uint64_t customHistory;
+
+    // TAGE and hashed perceptron
+    struct HistoryBuffer historyBuffer;
+    uint32_t phistory;
+    struct FoldedHistory foldedHistory[TAGE_MAX_TABLES][3];
+    uint16_t hashedFoldedHistory[HASHED_MAX_TABLES];
+};
 
 //------------------------------------//
 //        Predictor Functions         //
@@ -465,6 +1342,10 @@ struct CustomPredictor customPredictor;
 void
 init_predictor()
 {
+  if (filterBits > 0) {
+    init_bias_filter(&biasFilter, filterBits);
+  }
+
   switch(bpType) {
     case STATIC:
       break;
@@ -477,22 +1358,137 @@ init_predictor()
     case CUSTOM:
       init_custom_predictor(&customPredictor);
       break;
+    case TAGE:
+      init_tage_predictor(&tagePredictor, pcIndexBits, tageTables, tageIndexBits, tageTagBits, tageMinHistory, tageMaxHistory);
+      break;
+    case HASHED:
+      init_hashed_predictor(&hashedPredictor, hashedTables, hashedIndexBits, hashedMinHistory, hashedMaxHistory);
+      break;
     default:
       break;
   }
+  sizesReported = 1;
 }
 
-// Make a prediction for conditional branch instruction at PC 'pc'
-// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
-// indicates a prediction of not taken
+// Free the tables of the current predictor so it can be initialized again
 //
-uint8_t
-make_prediction(uint32_t pc)
+void
+gc_predictor()
 {
-  //
-  //TODO: Implement prediction scheme
-  //
+  if (filterBits > 0) {
+    gc_bias_filter(&biasFilter);
+  }
+
+  switch(bpType) {
+    case STATIC:
+      break;
+    case GSHARE:
+      gc_gshare_predictor(&gsharePredictor);
+      break;
+    case TOURNAMENT:
+      gc_tournament_predictor(&tournamentPredictor);
+      break;
+    case CUSTOM:
+      gc_custom_predictor(&customPredictor);
+      break;
+    case TAGE:
+      gc_tage_predictor(&tagePredictor);
+      break;
+    case HASHED:
+      gc_hashed_predictor(&hashedPredictor);
+      break;
+    default:
+      break;
+  }
+}
+
+// Allocate a history snapshot holding the current history of the predictor
+//
+struct PredictorHistory *
+alloc_predictor_history()
+{
+  struct PredictorHistory *history = (struct PredictorHistory *) malloc(sizeof(struct PredictorHistory));
+  assert(history != NULL);
+  save_predictor_history(history);
+  return history;
+}
+
+// Copy the global history of the current predictor into 'history'
+//
+void
+save_predictor_history(struct PredictorHistory *history)
+{
+  switch(bpType) {
+    case GSHARE:
+      history->ghistory = gsharePredictor.ghistory;
+      break;
+    case TOURNAMENT:
+      history->ghistory = tournamentPredictor.ghistory;
+      break;
+    case CUSTOM:
+      history->customHistory = customPredictor.ghistory;
+      break;
+    case TAGE:
+      history->historyBuffer = tagePredictor.ghistory;
+      history->phistory = tagePredictor.phistory;
+      for (int i = 0; i < tagePredictor.nTables; i++) {
+        history->foldedHistory[i][0] = tagePredictor.indexHistory[i];
+        history->foldedHistory[i][1] = tagePredictor.tagHistory[i][0];
+        history->foldedHistory[i][2] = tagePredictor.tagHistory[i][1];
+      }
+      break;
+    case HASHED:
+      history->historyBuffer = hashedPredictor.ghistory;
+      history->phistory = hashedPredictor.phistory;
+      memcpy(history->hashedFoldedHistory, hashedPredictor.foldedHistory, sizeof(hashedPredictor.foldedHistory));
+      break;
+    default:
+      break;
+  }
+}
 
+// Replace the global history of the current predictor with 'history'
+//
+void
+restore_predictor_history(struct PredictorHistory *history)
+{
+  switch(bpType) {
+    case GSHARE:
+      gsharePredictor.ghistory = history->ghistory;
+      break;
+    case TOURNAMENT:
+      tournamentPredictor.ghistory = history->ghistory;
+      break;
+    case CUSTOM:
+      customPredictor.ghistory = history->customHistory;
+      break;
+    case TAGE:
+      tagePredictor.ghistory = history->historyBuffer;
+      tagePredictor.phistory = history->phistory;
+      for (int i = 0; i < tagePredictor.nTables; i++) {
+        tagePredictor.indexHistory[i] = history->foldedHistory[i][0];
+        tagePredictor.tagHistory[i][0] = history->foldedHistory[i][1];
+        tagePredictor.tagHistory[i][1] = history->foldedHistory[i][2];
+      }
+      tagePredictor.lookupValid = 0;
+      break;
+    case HASHED:
+      hashedPredictor.ghistory = history->historyBuffer;
+      hashedPredictor.phistory = history->phistory;
+      memcpy(hashedPredictor.foldedHistory, history->hashedFoldedHistory, sizeof(hashedPredictor.foldedHistory));
+      hashedPredictor.lookupValid = 0;
+      break;
+    default:
+      break;
+  }
+}
+
+// Make a prediction with the predictor selected by bpType,
+// bypassing the bias filter
+//
+uint8_t
+make_prediction_backing(uint32_t pc)
+{
   // Make a prediction based on the bpType
   switch (bpType) {
     case STATIC:
@@ -503,6 +1499,10 @@ make_prediction(uint32_t pc)
       return make_prediction_tournament_predictor(&tournamentPredictor, pc);
     case CUSTOM:
       return make_prediction_custom_predictor(&customPredictor, pc);
+    case TAGE:
+      return make_prediction_tage_predictor(&tagePredictor, pc);
+    case HASHED:
+      return make_prediction_hashed_predictor(&hashedPredictor, pc);
     default:
       break;
   }
@@ -511,16 +1511,60 @@ make_prediction(uint32_t pc)
   return NOTTAKEN;
 }
 
-// Train the predictor the last executed branch at PC 'pc' and with
-// outcome 'outcome' (true indicates that the branch was taken, false
-// indicates that the branch was not taken)
+// Make a prediction for conditional branch instruction at PC 'pc'
+// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
+// indicates a prediction of not taken
+//
+uint8_t
+make_prediction(uint32_t pc)
+{
+  // Confidently biased branches never reach the backing predictor.
+  if (filterBits > 0) {
+    uint8_t prediction;
+    biasFilter.lookups++;
+    if (lookup_bias_filter(&biasFilter, pc, &prediction)) {
+      biasFilter.hits++;
+      return prediction;
+    }
+  }
+  return make_prediction_backing(pc);
+}
+
+// Shift a branch handled by the bias filter into the history of
+// the predictor selected by bpType, leaving its tables untouched
 //
 void
-train_predictor(uint32_t pc, uint8_t outcome)
+update_history_backing(uint32_t pc, uint8_t outcome)
+{
+  switch (bpType)
+  {
+    case STATIC:
+      break;
+    case GSHARE:
+      update_history_gshare_predictor(&gsharePredictor, outcome);
+      break;
+    case TOURNAMENT:
+      update_history_tournament_predictor(&tournamentPredictor, pc, outcome);
+      break;
+    case CUSTOM:
+      update_history_custom_predictor(&customPredictor, outcome);
+      break;
+    case TAGE:
+      update_history_tage_predictor(&tagePredictor, pc, outcome);
+      break;
+    case HASHED:
+      update_history_hashed_predictor(&hashedPredictor, pc, outcome);
+      break;
+    default:
+      break;
+  }
+}
+
+// Train the predictor selected by bpType, bypassing the bias filter
+//
+void
+train_predictor_backing(uint32_t pc, uint8_t outcome)
 {
-  //
-  //TODO: Implement Predictor training
-  //
   switch (bpType)
   {
     case STATIC:
@@ -534,7 +1578,114 @@ train_predictor(uint32_t pc, uint8_t outcome)
     case CUSTOM:
       train_custom_predictor(&customPredictor, pc, outcome);
       break;
+    case TAGE:
+      train_tage_predictor(&tagePredictor, pc, outcome);
+      break;
+    case HASHED:
+      train_hashed_predictor(&hashedPredictor, pc, outcome);
+      break;
     default:
       break;
   }
 }
+
+// Train the predictor the last executed branch at PC 'pc' and with
+// outcome 'outcome' (true indicates that the branch was taken, false
+// indicates that the branch was not taken)
+//
+void
+train_predictor(uint32_t pc, uint8_t outcome)
+{
+  // Branches the filter predicted correctly do not train (or pollute) the backing
+  // predictor tables, but still appear in its history. A biased branch that breaks
+  // its bias trains the backing predictor, which has to learn that exception.
+  if (filterBits > 0) {
+    uint8_t prediction;
+    uint8_t handled = lookup_bias_filter(&biasFilter, pc, &prediction) && prediction == outcome;
+    train_bias_filter(&biasFilter, pc, outcome);
+    if (handled) {
+      update_history_backing(pc, outcome);
+      return;
+    }
+  }
+  train_predictor_backing(pc, outcome);
+}
+
+// Cycles to read a table of `sizeBits` bits: one cycle up to
+// LATENCY_SINGLE_CYCLE_BITS, plus one for every 4x beyond that
+//
+int
+table_latency(uint64_t sizeBits)
+{
+  int latency = 1;
+  for (uint64_t size = LATENCY_SINGLE_CYCLE_BITS; size < sizeBits; size *= 4) {
+    latency++;
+  }
+  return latency;
+}
+
+// Cycles to add `inputs` values with a binary adder tree
+//
+int
+adder_tree_latency(int inputs)
+{
+  int levels = 0;
+  while ((1 << levels) < inputs) {
+    levels++;
+  }
+  return (levels + LATENCY_ADDER_LEVELS_PER_CYCLE - 1) / LATENCY_ADDER_LEVELS_PER_CYCLE;
+}
+
+// Estimated number of cycles needed by the predictor selected by
+// bpType to produce a prediction, derived from its table sizes
+//
+int
+get_backing_lookup_latency()
+{
+  switch (bpType) {
+    case STATIC:
+      return 0;
+    case GSHARE:
+      return table_latency((uint64_t) 2 << ghistoryBits);
+    case TOURNAMENT:
+      // The local history table and the local counters are read one after the other;
+      // the global and choice tables are read in parallel with them.
+      return max(table_latency((uint64_t) lhistoryBits << pcIndexBits) + table_latency((uint64_t) 2 << lhistoryBits),
+                 table_latency((uint64_t) 2 << ghistoryBits));
+    case CUSTOM:
+      return table_latency((uint64_t) (CUSTOM_GHISTORY_BITS + 1) * (CUSTOM_WEIGHTS_BITS + 1) << CUSTOM_PC_INDEX_BITS)
+           + adder_tree_latency(CUSTOM_GHISTORY_BITS + 1);
+    case TAGE:
+      // Tagged tables are read in parallel, then one cycle for tag match and provider selection.
+      return max(table_latency((uint64_t) 2 << pcIndexBits),
+                 table_latency((uint64_t) (tageTagBits + TAGE_COUNTER_BITS + TAGE_USEFUL_BITS) << tageIndexBits)) + 1;
+    case HASHED:
+      return table_latency((uint64_t) HASHED_WEIGHTS_BITS << hashedIndexBits) + adder_tree_latency(hashedTables);
+    default:
+      break;
+  }
+  return 0;
+}
+
+// Estimated number of cycles needed to produce a prediction. The bias
+// filter is read first and only misses go on to the backing predictor
+//
+int
+get_predictor_lookup_latency()
+{
+  int latency = get_backing_lookup_latency();
+  if (filterBits > 0) {
+    latency += table_latency((uint64_t) (FILTER_CONFIDENCE_BITS + 1) << filterBits);
+  }
+  return latency;
+}
+
+// Print predictor specific statistics gathered during the run
+//
+void
+print_predictor_stats()
+{
+  if (filterBits > 0) {
+    print_bias_filter_stats(&biasFilter);
+  }
+}
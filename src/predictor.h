@@ -30,6 +30,8 @@ extern const char *email;
 #define GSHARE      1
 #define TOURNAMENT  2
 #define CUSTOM      3
+#define TAGE        4
+#define HASHED      5
 extern const char *bpName[];
 
 // Definitions for 2-bit counters
@@ -43,6 +45,33 @@ extern const char *bpName[];
 #define CUSTOM_PC_INDEX_BITS 8
 #define CUSTOM_TRAINING_THRESHOLD_BITS 6
 #define CUSTOM_WEIGHTS_BITS 7
+#define CUSTOM_BUDGET_BITS (64 * 1024 + 256)
+
+// TAGE predictor
+#define TAGE_MAX_TABLES 16
+#define TAGE_HISTORY_BUFFER_BITS 1024    // Capacity of the circular global history (power of 2)
+#define TAGE_PATH_HISTORY_BITS 16
+#define TAGE_COUNTER_BITS 3
+#define TAGE_USEFUL_BITS 2
+#define TAGE_USE_ALT_BITS 4
+#define TAGE_USEFUL_RESET_PERIOD (1 << 18) // Branches between graceful resets of the useful bits
+
+// Hashed perceptron predictor (shares the history buffer of the TAGE predictor)
+#define HASHED_MAX_TABLES 16 // One SIMD lane per table
+#define HASHED_WEIGHTS_BITS 6
+#define HASHED_THETA_BITS 7
+
+// Bias filter
+#define FILTER_CONFIDENCE_BITS 4   // Consecutive same-direction outcomes before a PC is filtered
+#define FILTER_MAX_BITS 24          // Largest accepted --filter index
+
+// Lookup latency model
+#define LATENCY_SINGLE_CYCLE_BITS (16 * 1024) // Largest table read in a single cycle
+#define LATENCY_ADDER_LEVELS_PER_CYCLE 4       // Adder tree levels evaluated per cycle
+
+// Timing
+#define TIMING_SAMPLE_PERIOD 64    // Time one in every N branches
+#define TIMING_SAMPLE_MAX_NS 10000 // Discard timing samples longer than this
 
 //------------------------------------//
 //      Predictor Configuration       //
@@ -50,6 +79,16 @@ extern const char *bpName[];
 extern int ghistoryBits; // Number of bits used for Global History
 extern int lhistoryBits; // Number of bits used for Local History
 extern int pcIndexBits;  // Number of bits used for PC index
+extern int tageTables;   // Number of tagged TAGE tables
+extern int tageIndexBits; // Number of bits used to index each tagged TAGE table
+extern int tageTagBits;  // Number of tag bits in each tagged TAGE entry
+extern int tageMinHistory; // History length of the shortest tagged TAGE table
+extern int tageMaxHistory; // History length of the longest tagged TAGE table
+extern int hashedTables; // Number of hashed perceptron weight tables
+extern int hashedIndexBits; // Number of bits used to index each hashed perceptron table
+extern int hashedMinHistory; // History length covered by the first hashed perceptron segment
+extern int hashedMaxHistory; // History length covered by all hashed perceptron segments
+extern int filterBits;   // Number of bits used for bias filter index (0 disables it)
 extern int bpType;       // Branch Prediction Type
 extern int verbose;
 
@@ -77,4 +116,30 @@ uint8_t make_prediction(uint32_t pc);
 //
 void train_predictor(uint32_t pc, uint8_t outcome);
 
+// Free the predictor tables so init_predictor can be called again
+//
+void gc_predictor();
+
+// Global history of the predictor, saved and restored when switching
+// between interleaved traces. Allocated with the current history, freed with free()
+//
+struct PredictorHistory;
+struct PredictorHistory *alloc_predictor_history();
+void save_predictor_history(struct PredictorHistory *history);
+void restore_predictor_history(struct PredictorHistory *history);
+
+// Print predictor specific statistics gathered during the run
+//
+void print_predictor_stats();
+
+// Estimated number of cycles needed to produce a prediction,
+// derived from the table sizes of the configured predictor
+//
+int get_predictor_lookup_latency();
+
+// Monotonic time in nanoseconds, and the cost of reading it twice
+//
+uint64_t get_time_ns();
+uint64_t get_timer_overhead_ns();
+
 #endif